@@ -0,0 +1,66 @@
+﻿namespace WinFormsChaosApp
+{
+    public enum ChangeKind
+    {
+        Added,
+        Removed,
+        Value,
+        Meta
+    }
+
+    /// <summary>
+    /// A single journal entry - what happened to which plugin or parameter id
+    /// </summary>
+    public readonly record struct Change(ChangeKind Kind, uint ElementId);
+
+    /// <summary>
+    /// The journal and the undo steps of one MediatorVRMatAPI transaction
+    /// </summary>
+    internal sealed class Transaction
+    {
+        private readonly HashSet<Change> _seen = new();
+
+        public readonly List<Change> Changes = new();
+        public readonly List<Action<Rollback>> Undo = new();
+
+        // elements created inside the transaction, the listeners never saw them
+        public readonly HashSet<uint> Added = new();
+
+        public void Add(Change change)
+        {
+            // the journal is compact - repeated edits of the same element are reported once
+            if (_seen.Add(change))
+                Changes.Add(change);
+
+            if (change.Kind == ChangeKind.Added)
+                Added.Add(change.ElementId);
+        }
+    }
+
+    /// <summary>
+    /// The state of a rollback in progress.
+    /// Removed elements come back with new ids, later undo steps find them through Map()
+    /// </summary>
+    internal sealed class Rollback
+    {
+        private readonly Dictionary<uint, uint> _ids = new();
+
+        public readonly List<Change> Changes = new();
+
+        public uint Map(uint id)
+        {
+            return _ids.TryGetValue(id, out var mapped) ? mapped : id;
+        }
+
+        public void Restored(uint oldId, uint newId, bool visible)
+        {
+            _ids[oldId] = newId;
+
+            if (visible)
+            {
+                Changes.Add(new Change(ChangeKind.Removed, oldId));
+                Changes.Add(new Change(ChangeKind.Added, newId));
+            }
+        }
+    }
+}
@@ -0,0 +1,225 @@
+﻿using System.Numerics;
+using static WinFormsChaosApp.VRMatAPI;
+
+namespace WinFormsChaosApp
+{
+    /// <summary>
+    /// Finds plugins or parameters by plugin type and class, parameter name, meta and value.
+    /// With no parameter filter the query returns plugin ids, otherwise the ids of the matching parameters
+    /// </summary>
+    /// <example>
+    /// every color with a red channel above 0.9:
+    /// new ContainerQuery().ParamType("color").Component(0, 0.9f, float.MaxValue).Run(vr);
+    /// every file path parameter of the BitmapBuffer plugins:
+    /// new ContainerQuery().PluginType("BitmapBuffer").FilePath().Run(vr);
+    /// </example>
+    public sealed class ContainerQuery
+    {
+        private string? _pluginType;
+        private string? _pluginClass;
+        private string? _paramName;
+        private string? _paramType;
+        private bool? _filePath;
+        private bool? _custom;
+        private readonly List<Func<ParamValue, bool>> _predicates = new();
+        private readonly List<(int Component, float Min, float Max)> _ranges = new();
+
+        private bool HasParamFilter => _paramName != null || _paramType != null || _filePath != null || _custom != null || _predicates.Count > 0 || _ranges.Count > 0;
+
+        public ContainerQuery PluginType(string type)
+        {
+            _pluginType = type;
+            return this;
+        }
+
+        public ContainerQuery PluginClass(string klass)
+        {
+            _pluginClass = klass;
+            return this;
+        }
+
+        public ContainerQuery ParamName(string name)
+        {
+            _paramName = name;
+            return this;
+        }
+
+        public ContainerQuery ParamType(string type)
+        {
+            _paramType = type;
+            return this;
+        }
+
+        public ContainerQuery FilePath(bool filePath = true)
+        {
+            _filePath = filePath;
+            return this;
+        }
+
+        public ContainerQuery Custom(bool custom = true)
+        {
+            _custom = custom;
+            return this;
+        }
+
+        /// <summary>
+        /// Keeps parameters whose value satisfies the predicate
+        /// </summary>
+        public ContainerQuery Where(Func<ParamValue, bool> predicate)
+        {
+            _predicates.Add(predicate);
+            return this;
+        }
+
+        /// <summary>
+        /// Keeps float parameters where the given component of the value (or of any list entry) is within [min, max].
+        /// e.g. component 0 is red for colors and x for vectors
+        /// </summary>
+        public ContainerQuery Component(int component, float min, float max)
+        {
+            _ranges.Add((component, min, max));
+            return this;
+        }
+
+        public List<uint> Run(MediatorVRMatAPI vr)
+        {
+            var plugins = new List<uint>();
+            foreach (var pluginId in vr.Index.PluginIds)
+            {
+                if (MatchesPlugin(vr, pluginId))
+                    plugins.Add(pluginId);
+            }
+
+            if (!HasParamFilter)
+                return plugins;
+
+            var candidates = new List<uint>();
+            foreach (var pluginId in plugins)
+            {
+                if (_paramName != null)
+                {
+                    uint paramId = vr.GetElementId(pluginId, _paramName);
+                    if (paramId != 0 && MatchesParamMeta(vr, paramId))
+                        candidates.Add(paramId);
+                }
+                else
+                {
+                    foreach (var paramId in vr.ParamIds(pluginId))
+                    {
+                        if (MatchesParamMeta(vr, paramId))
+                            candidates.Add(paramId);
+                    }
+                }
+            }
+
+            if (_predicates.Count == 0 && _ranges.Count == 0)
+                return candidates;
+
+            var values = vr.TryGetValues(candidates);
+            var matches = new bool[values.Length];
+
+            for (int i = 0; i < values.Length; i++)
+                matches[i] = values[i] != null && _predicates.All(predicate => predicate(values[i]!));
+
+            foreach (var range in _ranges)
+                ScanRange(values, matches, range.Component, range.Min, range.Max);
+
+            var result = new List<uint>();
+            for (int i = 0; i < values.Length; i++)
+            {
+                if (matches[i])
+                    result.Add(values[i]!.ParamId);
+            }
+
+            return result;
+        }
+
+        /// <summary>
+        /// Runs the query over every container in parallel, the results are in the order of the containers
+        /// </summary>
+        public List<uint>[] Run(IReadOnlyList<MediatorVRMatAPI> containers)
+        {
+            var results = new List<uint>[containers.Count];
+            Parallel.For(0, containers.Count, i => results[i] = Run(containers[i]));
+            return results;
+        }
+
+        private bool MatchesPlugin(MediatorVRMatAPI vr, uint pluginId)
+        {
+            if (_pluginType == null && _pluginClass == null)
+                return true;
+
+            var meta = vr.GetMetaNative(pluginId, MetaCategories.PluginType | MetaCategories.PluginClass);
+
+            return (_pluginType == null || vr.Strings.FromNative(meta.pluginType) == _pluginType)
+                && (_pluginClass == null || vr.Strings.FromNative(meta.pluginClass) == _pluginClass);
+        }
+
+        private bool MatchesParamMeta(MediatorVRMatAPI vr, uint paramId)
+        {
+            if (_paramType == null && _filePath == null && _custom == null)
+                return true;
+
+            var meta = vr.GetMetaNative(paramId, MetaCategories.ParamType | MetaCategories.ParamCustom | MetaCategories.ParamFilePath);
+
+            return (_paramType == null || vr.Strings.FromNative(meta.paramType) == _paramType)
+                && (_filePath == null || (meta.paramFilePath != 0) == _filePath)
+                && (_custom == null || (meta.paramCustom != 0) == _custom);
+        }
+
+        /// <summary>
+        /// Gathers the requested component of every float value into one packed buffer and tests it with SIMD compares
+        /// </summary>
+        private static void ScanRange(ParamValue?[] values, bool[] matches, int component, float min, float max)
+        {
+            var packed = new List<float>();
+            var owners = new List<int>();
+            var found = new bool[values.Length];
+
+            for (int i = 0; i < values.Length; i++)
+            {
+                var value = values[i];
+                if (!matches[i] || value == null || value.Rdt != Rdt.Float || value.Floats == null || component >= value.Components)
+                    continue;
+
+                for (int entry = component; entry < value.Floats.Length; entry += value.Components)
+                {
+                    packed.Add(value.Floats[entry]);
+                    owners.Add(i);
+                }
+            }
+
+            var data = packed.ToArray();
+            int width = Vector<float>.Count, index = 0;
+
+            if (Vector.IsHardwareAccelerated)
+            {
+                var lower = new Vector<float>(min);
+                var upper = new Vector<float>(max);
+
+                for (; index <= data.Length - width; index += width)
+                {
+                    var v = new Vector<float>(data, index);
+                    var inRange = Vector.GreaterThanOrEqual(v, lower) & Vector.LessThanOrEqual(v, upper);
+                    if (inRange == Vector<int>.Zero)
+                        continue;
+
+                    for (int lane = 0; lane < width; lane++)
+                    {
+                        if (inRange[lane] != 0)
+                            found[owners[index + lane]] = true;
+                    }
+                }
+            }
+
+            for (; index < data.Length; index++)
+            {
+                if (data[index] >= min && data[index] <= max)
+                    found[owners[index]] = true;
+            }
+
+            for (int i = 0; i < matches.Length; i++)
+                matches[i] &= found[i];
+        }
+    }
+}
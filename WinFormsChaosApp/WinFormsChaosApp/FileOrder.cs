@@ -0,0 +1,33 @@
+﻿namespace WinFormsChaosApp
+{
+    /// <summary>
+    /// The plugin and parameter ids of a container in the order of its source document.
+    /// Elements added after loading are appended, removed ones are skipped by the reader
+    /// </summary>
+    internal sealed class FileOrder
+    {
+        public readonly List<uint> Plugins = new();
+        public readonly Dictionary<uint, List<uint>> Params = new();
+
+        private readonly HashSet<uint> _known = new();
+
+        public bool Contains(uint id) => _known.Contains(id);
+
+        public void AddPlugin(uint pluginId)
+        {
+            if (!_known.Add(pluginId))
+                return;
+
+            Plugins.Add(pluginId);
+            Params[pluginId] = new List<uint>();
+        }
+
+        public void AddParameter(uint pluginId, uint paramId)
+        {
+            if (!Params.TryGetValue(pluginId, out var paramIds) || !_known.Add(paramId))
+                return;
+
+            paramIds.Add(paramId);
+        }
+    }
+}
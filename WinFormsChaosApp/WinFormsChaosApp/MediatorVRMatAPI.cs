@@ -1,15 +1,91 @@
-﻿using System.Xml.Linq;
+﻿using System.Collections.Concurrent;
+using System.Runtime.ExceptionServices;
+using System.Runtime.InteropServices;
+using System.Xml.Linq;
 using static WinFormsChaosApp.VRMatAPI;
 
 namespace WinFormsChaosApp
 {
+    /// <summary>
+    /// Called for every plugin (paramId == 0) and then for each of its parameters. Return false to stop the walk
+    /// </summary>
+    public delegate bool ElementVisitor(uint pluginId, uint paramId);
+
+    /// <summary>
+    /// Wraps a single data container.
+    /// An instance is not thread-safe, but instances share no managed state, so separate mediators can be used from separate threads
+    /// </summary>
     public class MediatorVRMatAPI : IDisposable
     {
+        // a single delegate instance for all value reads - no per-call delegate marshalling and it never gets collected
+        private static readonly ValueCallback _valueCallback = OnValue;
+        private static readonly ValueCallback _idCallback = OnId;
+
         private readonly string _file;
-        public MediatorVRMatAPI(string file)
+        private NameIndex? _index;
+        private ReferenceGraph? _graph;
+        private FileOrder? _fileOrder;
+
+        // the last buffer given to Container(), the source of the file order when there is no file
+        private string? _buffer;
+        private readonly StringPool _strings = new();
+
+        private Transaction? _transaction;
+        private bool _replaying;
+
+        // holds copies of the plugins removed in the current transaction, so a rollback can restore them
+        private MediatorVRMatAPI? _scratch;
+
+        public MediatorVRMatAPI(string file) : this(file, true)
+        {
+        }
+
+        private MediatorVRMatAPI(string file, bool open)
         {
             _file = file;
-            Open();
+
+            if (open)
+                Open();
+            else
+                Create();
+        }
+
+        /// <summary>
+        /// Opens every file into its own container on the thread pool.
+        /// Files are handed out one at a time, so a few large files do not hold up a worker's whole share of the list.
+        /// The callback is invoked from worker threads, with either the opened container or the error.
+        /// It returns true to take ownership of the container, which the caller then has to dispose, otherwise the container is disposed once it returns
+        /// </summary>
+        public static void OpenMany(IEnumerable<string> files, Func<string, MediatorVRMatAPI?, Exception?, bool> onResult, int maxDegreeOfParallelism = -1)
+        {
+            var options = new ParallelOptions { MaxDegreeOfParallelism = maxDegreeOfParallelism };
+            var partitioner = Partitioner.Create(files, EnumerablePartitionerOptions.NoBuffering);
+
+            Parallel.ForEach(partitioner, options, file =>
+            {
+                MediatorVRMatAPI? vr = null;
+                Exception? error = null;
+
+                try
+                {
+                    vr = new MediatorVRMatAPI(file);
+                }
+                catch (Exception e)
+                {
+                    error = e;
+                }
+
+                bool kept = false;
+                try
+                {
+                    kept = onResult(file, vr, error);
+                }
+                finally
+                {
+                    if (!kept)
+                        vr?.Dispose();
+                }
+            });
         }
 
         ~MediatorVRMatAPI()
@@ -18,22 +94,366 @@ namespace WinFormsChaosApp
         }
 
         public nint Dysplay { get; set; }
+
+        /// <summary>
+        /// The name index of the container. It is built with one pass over the plugins on first use,
+        /// so all edits must go through the mediator to keep it current
+        /// </summary>
+        public NameIndex Index => _index ??= BuildIndex();
+
+        /// <summary>
+        /// The plugin reference graph of the container, built on first use and kept current like the name index
+        /// </summary>
+        public ReferenceGraph Graph => _graph ??= BuildGraph();
+
+        /// <summary>
+        /// The pool of all names, types and string values copied out of the container
+        /// </summary>
+        public StringPool Strings => _strings;
+
+        /// <summary>
+        /// Fired once per committed transaction with its compact journal of changed element ids.
+        /// Edits made outside a transaction are reported one by one
+        /// </summary>
+        public event Action<IReadOnlyList<Change>>? Committed;
+
+        public bool InTransaction => _transaction != null;
+
+        /// <summary>
+        /// Starts batching edits. Every mutation until Commit() or Rollback() is journaled, and can be undone
+        /// </summary>
+        public void BeginTransaction()
+        {
+            if (_transaction != null)
+                throw new Exception("VR Exception! A transaction is already active.");
+
+            _transaction = new Transaction();
+        }
+
+        /// <summary>
+        /// Ends the transaction and notifies the Committed subscribers once with all changes
+        /// </summary>
+        public IReadOnlyList<Change> Commit()
+        {
+            var transaction = _transaction ?? throw new Exception("VR Exception! There is no active transaction.");
+
+            _transaction = null;
+            DisposeScratch();
+
+            if (transaction.Changes.Count > 0)
+                Committed?.Invoke(transaction.Changes);
+
+            return transaction.Changes;
+        }
+
+        /// <summary>
+        /// Undoes every edit of the transaction in reverse order.
+        /// Removed plugins and parameters, and parameters that had no value before it was set, are added back with new ids.
+        /// The subscribers are notified about those only.
+        /// A step that fails does not stop the others - the subscribers still hear about what was restored,
+        /// then the failures are thrown together
+        /// </summary>
+        public void Rollback()
+        {
+            var transaction = _transaction ?? throw new Exception("VR Exception! There is no active transaction.");
+            var rollback = new Rollback();
+            var failures = new List<Exception>();
+
+            _transaction = null;
+            _replaying = true;
+
+            try
+            {
+                for (int i = transaction.Undo.Count - 1; i >= 0; i--)
+                {
+                    try
+                    {
+                        transaction.Undo[i](rollback);
+                    }
+                    catch (Exception e)
+                    {
+                        failures.Add(e);
+                    }
+                }
+            }
+            finally
+            {
+                _replaying = false;
+                DisposeScratch();
+            }
+
+            if (rollback.Changes.Count > 0)
+                Committed?.Invoke(rollback.Changes);
+
+            if (failures.Count > 0)
+                throw new AggregateException("VR Exception! The transaction was not rolled back completely.", failures);
+        }
+
         public uint AddPlugin(string name, string type, string klass)
         {
+            long start = VRMatStats.Begin();
             uint id = VRMatAPI.DataContainer_AddPlugin(Dysplay, name, type, klass);
+            VRMatStats.End(VRMatExport.AddPlugin, start);
 
             if (id < 1)
                 throw new Exception("VR Exception! The plugin was not added correctly.");
 
+            VRMatStats.AddPluginCreated();
+
+            // a new plugin has no parameters yet, so they are all indexed
+            _index?.AddPlugin(id, name);
+            _index?.AddParameters(id);
+            _fileOrder?.AddPlugin(id);
+
+            Record(ChangeKind.Added, id, rollback => RemoveElement(rollback.Map(id)));
+            return id;
+        }
+
+        public uint AddParameter(uint pluginId, string name, string type, int custom = 0)
+        {
+            long start = VRMatStats.Begin();
+            uint id = VRMatAPI.DataContainer_AddParameter(Dysplay, pluginId, name, type, custom);
+            VRMatStats.End(VRMatExport.AddParameter, start);
+
+            if (id < 1)
+                throw new Exception("VR Exception! The parameter was not added correctly.");
+
+            VRMatStats.AddParameterCreated();
+
+            _index?.AddParameter(pluginId, id, name);
+            _fileOrder?.AddParameter(pluginId, id);
+
+            if (_graph != null && ReferenceGraph.IsReferenceType(type))
+                _graph.AddParameter(pluginId, id);
+
+            Record(ChangeKind.Added, id, rollback => RemoveElement(rollback.Map(id)));
             return id;
         }
 
+        /// <summary>
+        /// Resolves a plugin name (pluginId == 0) or a parameter name of the given plugin through the name index
+        /// </summary>
+        /// <returns>The element id or 0 if there is no such element</returns>
+        public uint GetElementId(uint pluginId, string name)
+        {
+            if (pluginId == 0)
+                return Index.FindPlugin(name);
+
+            if (!Index.HasParameters(pluginId))
+                IndexParameters(pluginId);
+
+            return Index.FindParameter(pluginId, name);
+        }
+
+        public string GetUniqueName(string pluginName)
+        {
+            return Index.UniqueName(pluginName);
+        }
+
+        /// <summary>
+        /// Returns the ids of all plugins nested under a "/"-separated path, e.g. all sub-plugins of a material
+        /// </summary>
+        public IEnumerable<uint> FindPluginsUnder(string path)
+        {
+            return Index.FindPluginsUnder(path);
+        }
+
+        public void RemoveElement(uint elementId)
+        {
+            var undo = Recording ? CaptureRemoval(elementId) : null;
+
+            long start = VRMatStats.Begin();
+            bool isOK = VRMatAPI.DataContainer_RemoveElement(Dysplay, elementId) >= 1;
+            VRMatStats.End(VRMatExport.RemoveElement, start);
+            if (!isOK)
+                throw new Exception("VR Exception! The element was not removed correctly.");
+
+            _index?.Remove(elementId);
+            _graph?.Remove(elementId);
+
+            Record(ChangeKind.Removed, elementId, undo);
+        }
+
+        /// <summary>
+        /// Renames a plugin and rewrites every parameter that references it by the old name
+        /// </summary>
+        public void RenamePlugin(uint pluginId, string name)
+        {
+            var oldName = Index.PluginName(pluginId);
+            if (oldName == null)
+                throw new Exception("VR Exception! The plugin was not found.");
+
+            // only string values name plugins, read them all before anything changes
+            var referrers = TryGetValues(Graph.ReferrersOf(oldName).ToArray()).Where(value => value?.Rdt == Rdt.String).ToArray();
+
+            var meta = new Meta { mask = (uint)MetaCategories.PluginName, pluginName = name };
+            SetMeta(meta, pluginId);
+
+            foreach (var value in referrers)
+            {
+                var strings = value!.Strings!;
+                for (int i = 0; i < strings.Length; i++)
+                {
+                    if (strings[i] == oldName)
+                        strings[i] = name;
+                }
+
+                SetValue(value.ParamId, strings, value.IsList);
+            }
+        }
+
+        public List<uint> PluginIds()
+        {
+            return CollectIds(0);
+        }
+
+        public List<uint> ParamIds(uint pluginId)
+        {
+            return CollectIds(pluginId);
+        }
+
+        /// <summary>
+        /// Walks every plugin and every parameter in one call.
+        /// The id buffers and the native callback are shared by the whole walk, nothing is allocated per element
+        /// </summary>
+        /// <param name="fileOrder">Visit in the order of the source document instead of the container's order.
+        /// The order is established with one scan on first use and kept for later walks</param>
+        /// <returns>True if every element was visited, false if the visitor stopped the walk</returns>
+        public bool VisitAll(ElementVisitor visitor, bool fileOrder = false)
+        {
+            if (fileOrder)
+                return VisitFileOrder(visitor, _fileOrder ??= BuildFileOrder());
+
+            var plugins = new IdCollector();
+            var parameters = new IdCollector { Params = true };
+            var pluginsHandle = GCHandle.Alloc(plugins);
+            var paramsHandle = GCHandle.Alloc(parameters);
+
+            try
+            {
+                CollectIds(0, plugins, GCHandle.ToIntPtr(pluginsHandle));
+
+                foreach (var pluginId in plugins.Ids)
+                {
+                    if (!visitor(pluginId, 0))
+                        return false;
+
+                    CollectIds(pluginId, parameters, GCHandle.ToIntPtr(paramsHandle));
+                    foreach (var paramId in parameters.Ids)
+                    {
+                        if (!visitor(pluginId, paramId))
+                            return false;
+                    }
+                }
+            }
+            finally
+            {
+                pluginsHandle.Free();
+                paramsHandle.Free();
+            }
+
+            return true;
+        }
+
+        /// <summary>
+        /// Copies the whole container into a new one through the API, without saving and reloading XML.
+        /// The copy is independent - the original can be mutated or disposed freely
+        /// </summary>
+        public MediatorVRMatAPI Clone()
+        {
+            var copy = new MediatorVRMatAPI(_file, false) { _buffer = _buffer };
+
+            try
+            {
+                var root = GetMetaNative(0, MetaCategories.Root);
+                copy.SetMetaNative(0, ref root);
+
+                foreach (var pluginId in PluginIds())
+                    copy.CopyPlugin(this, pluginId, _strings.FromNative(GetMetaNative(pluginId, MetaCategories.PluginName).pluginName) ?? "");
+            }
+            catch
+            {
+                copy.Dispose();
+                throw;
+            }
+
+            return copy;
+        }
+
+        /// <summary>
+        /// Copies plugins of another container into this one in a single pass.
+        /// Names that are already taken get the next free "#N" suffix and every plugin reference between the copied plugins
+        /// is rewritten to the new names. References to plugins that are not copied are kept as they are.
+        /// Outside a transaction the merge is applied as a whole or not at all and listeners are notified once.
+        /// If undoing a failed merge fails too, the merge error is thrown with the rollback error in its Data["RollbackError"]
+        /// </summary>
+        /// <param name="roots">If given, only these plugins and the plugins they reference, directly or not, are copied</param>
+        /// <returns>The id of every copied plugin keyed by its id in the source</returns>
+        public Dictionary<uint, uint> MergeFrom(MediatorVRMatAPI source, IEnumerable<uint>? roots = null)
+        {
+            var plugins = roots == null ? source.PluginIds() : Reachable(source, roots);
+            var pluginMap = new Dictionary<uint, uint>(plugins.Count);
+            var renames = new Dictionary<string, string>(plugins.Count, StringComparer.Ordinal);
+
+            bool own = _transaction == null;
+            if (own)
+                BeginTransaction();
+
+            try
+            {
+                // every plugin is added before any value is copied, so forward references already know their new names
+                foreach (var pluginId in plugins)
+                {
+                    var name = source.Index.PluginName(pluginId) ?? "";
+                    var unique = Index.UniqueName(name);
+
+                    pluginMap[pluginId] = AddPlugin(unique, source, pluginId);
+                    if (unique != name)
+                        renames[name] = unique;
+                }
+
+                foreach (var pluginId in plugins)
+                    CopyParameters(source, pluginId, pluginMap[pluginId], null, renames);
+
+                if (own)
+                    Commit();
+            }
+            catch (Exception error) when (own)
+            {
+                try
+                {
+                    Rollback();
+                }
+                catch (Exception rollbackError)
+                {
+                    // the merge failure is what the caller needs to see, the incomplete rollback travels with it
+                    error.Data["RollbackError"] = rollbackError;
+                    ExceptionDispatchInfo.Throw(error);
+                }
+
+                throw;
+            }
+
+            return pluginMap;
+        }
+
         public void Container(string buffer, int length)
         {
+            long start = VRMatStats.Begin();
             bool isOK = VRMatAPI.DataContainer_Load(Dysplay, buffer, length) > 0;
+            VRMatStats.End(VRMatExport.Load, start, "load", null);
+
             if (!isOK)
                 throw new Exception("VR Exception! The container was not load correctly.");
 
+            // a length of 0 makes the loader measure the buffer itself
+            VRMatStats.AddBytesParsed(length > 0 ? length : buffer.Length);
+
+            _index = null;
+            _graph = null;
+            _fileOrder = null;
+            _buffer = buffer;
+            _strings.Clear();
         }
 
         public void Dispose()
@@ -43,58 +463,798 @@ namespace WinFormsChaosApp
         }
 
 
+        /// <summary>
+        /// Decodes the preview image of the loaded document - the buffer of the last Container() call, otherwise the opened file - into the destination.
+        /// A preview changed later through SetMeta() is not seen, read it with GetMeta().
+        /// Unlike GetMeta() with MetaCategories.RootPreview, the base64 text is never copied as a whole
+        /// </summary>
+        /// <returns>The number of image bytes written, 0 if the document has no preview</returns>
+        public long ReadPreview(Stream destination)
+        {
+            if (_buffer != null)
+                return VRMatScanner.ReadPreview(new StringReader(_buffer), destination);
+
+            return VRMatScanner.ReadPreview(_file, destination);
+        }
+
+        public ParamValue GetValue(uint paramId)
+        {
+            return GetValues(new[] { paramId })[0];
+        }
+
+        /// <summary>
+        /// Reads the values of several parameters with one shared callback and a single pinned collector
+        /// </summary>
+        public ParamValue[] GetValues(IReadOnlyList<uint> paramIds)
+        {
+            return ReadValues(paramIds, true)!;
+        }
+
+        /// <summary>
+        /// Same as GetValues(), but parameters without a readable value are reported as null instead of failing the batch
+        /// </summary>
+        public ParamValue?[] TryGetValues(IReadOnlyList<uint> paramIds)
+        {
+            return ReadValues(paramIds, false);
+        }
+
+        private ParamValue?[] ReadValues(IReadOnlyList<uint> paramIds, bool throwOnError)
+        {
+            var result = new ParamValue?[paramIds.Count];
+            var collector = new ValueCollector { Strings = _strings };
+            var handle = GCHandle.Alloc(collector);
+
+            try
+            {
+                var userData = GCHandle.ToIntPtr(handle);
+                for (int i = 0; i < paramIds.Count; i++)
+                {
+                    collector.Current = null;
+                    long start = VRMatStats.Begin();
+                    bool isOK = VRMatAPI.DataContainer_GetValue(Dysplay, paramIds[i], _valueCallback, userData) >= 1;
+                    VRMatStats.End(VRMatExport.GetValue, start);
+
+                    if ((!isOK || collector.Current == null) && throwOnError)
+                        throw new Exception($"VR Exception! The value of parameter {paramIds[i]} was not read correctly.");
+
+                    result[i] = isOK ? collector.Current : null;
+                }
+            }
+            finally
+            {
+                handle.Free();
+            }
+
+            return result;
+        }
+
+        public void SetValue(uint paramId, float[] values, Stdt stdt, bool isList = false)
+        {
+            int components = ParamValue.ComponentCount(stdt);
+            CheckLength(values, components, isList);
+
+            SetNative(paramId, values, (uint)Rdt.Float | (uint)stdt | (uint)(isList ? Sqdt.List : Sqdt.Single), isList ? values.Length / components : 0);
+        }
+
+        public void SetValue(uint paramId, int[] values, bool isList = false)
+        {
+            CheckLength(values, 1, isList);
+            SetNative(paramId, values, (uint)Rdt.Int | (uint)Stdt.Single | (uint)(isList ? Sqdt.List : Sqdt.Single), isList ? values.Length : 0);
+        }
+
+        public void SetValue(uint paramId, string?[] values, bool isList = false)
+        {
+            CheckLength(values, 1, isList);
+            var pointers = new IntPtr[values.Length];
+
+            try
+            {
+                for (int i = 0; i < values.Length; i++)
+                    pointers[i] = values[i] == null ? IntPtr.Zero : Marshal.StringToHGlobalAnsi(values[i]);
+
+                SetNative(paramId, pointers, (uint)Rdt.String | (uint)Stdt.Single | (uint)(isList ? Sqdt.List : Sqdt.Single), isList ? values.Length : 0);
+            }
+            finally
+            {
+                foreach (var pointer in pointers)
+                    Marshal.FreeHGlobal(pointer);
+            }
+
+            _graph?.SetTargets(paramId, values);
+        }
+
+        public void SetValue(ParamValue value)
+        {
+            if (value.Rdt == Rdt.Float)
+                SetValue(value.ParamId, value.Floats ?? Array.Empty<float>(), value.Stdt, value.IsList);
+            else if (value.Rdt == Rdt.Int)
+                SetValue(value.ParamId, value.Ints ?? Array.Empty<int>(), value.IsList);
+            else if (value.Rdt == Rdt.String)
+                SetValue(value.ParamId, value.Strings ?? Array.Empty<string?>(), value.IsList);
+            else
+                throw new Exception($"VR Exception! The value of parameter {value.ParamId} has no data type.");
+        }
+
+        public void SetValues(IEnumerable<ParamValue> values)
+        {
+            foreach (var value in values)
+                SetValue(value);
+        }
+
+        /// <summary>
+        /// Sets one single (non-list) float structure per parameter from a packed buffer.
+        /// The buffer is pinned once for the whole batch, e.g. 3 floats per parameter for Stdt.Array3 colors
+        /// </summary>
+        public void SetValues(IReadOnlyList<uint> paramIds, float[] packed, Stdt stdt)
+        {
+            int components = ParamValue.ComponentCount(stdt);
+            if (packed.Length != paramIds.Count * components)
+                throw new ArgumentException("The packed buffer does not match the number of parameters.", nameof(packed));
+
+            SetPacked(paramIds, packed, sizeof(float) * components, (uint)Rdt.Float | (uint)stdt | (uint)Sqdt.Single);
+        }
+
+        /// <summary>
+        /// Sets one single integer per parameter from a packed buffer
+        /// </summary>
+        public void SetValues(IReadOnlyList<uint> paramIds, int[] packed)
+        {
+            if (packed.Length != paramIds.Count)
+                throw new ArgumentException("The packed buffer does not match the number of parameters.", nameof(packed));
+
+            SetPacked(paramIds, packed, sizeof(int), (uint)Rdt.Int | (uint)Stdt.Single | (uint)Sqdt.Single);
+        }
+
         public Meta GetMeta(Meta meta, uint element = 1)
         {
-            bool isOK = VRMatAPI.DataContainer_GetMeta(Dysplay, element, ref meta) >= 1;
+            // the strings are copied from the native pointers, the marshaller must not free what the container owns
+            var result = ToMeta(GetMetaNative(element, (MetaCategories)meta.mask));
 
-            if (!isOK)
-                throw new Exception("VR Exception! The get meta was not load correctly.");
+            if ((result.mask & (uint)MetaCategories.RootPreview) != 0)
+                VRMatStats.AddPreviewBytes(result.preview?.Length ?? 0);
 
-            return meta;
+            return result;
         }
 
         public void Save(string file, int version = 1)
         {
+            long start = VRMatStats.Begin();
             bool isSaved = VRMatAPI.DataContainer_Save(Dysplay, file, version) >= 1;
+            VRMatStats.End(VRMatExport.Save, start, "save", file);
+
             if (!isSaved)
                 throw new Exception("VR Exception! The file was not saved correctly.");
         }
 
         public Meta SetMeta(Meta meta, uint element = 1)
         {
+            Meta? old = Recording ? ToMeta(GetMetaNative(element, (MetaCategories)meta.mask)) : null;
+
+            long start = VRMatStats.Begin();
             bool isOK = VRMatAPI.DataContainer_SetMeta(Dysplay, element, ref meta) >= 1;
+            VRMatStats.End(VRMatExport.SetMeta, start);
+
+            if (!isOK)
+                throw new Exception("VR Exception! The get meta was not load correctly.");
+
+            if ((meta.mask & (uint)MetaCategories.PluginName) != 0 && meta.pluginName != null && _index != null && _index.IsPlugin(element))
+                _index.RenamePlugin(element, meta.pluginName);
+
+            if ((meta.mask & (uint)MetaCategories.ParamName) != 0 && meta.paramName != null && _index != null && _index.IsParameter(element))
+                _index.RenameParameter(element, meta.paramName);
+
+            // the type of a plugin element is in pluginType, a ParamType mask on it must not touch the graph
+            if ((meta.mask & (uint)MetaCategories.ParamType) != 0 && _graph != null && !Index.IsPlugin(element))
+            {
+                if (!_graph.IsReference(element) && ReferenceGraph.IsReferenceType(meta.paramType))
+                {
+                    var value = TryGetValue(element);
+                    _graph.AddParameter(value?.PluginId ?? OwnerOf(element), element);
+                    _graph.SetTargets(element, value?.Strings ?? Array.Empty<string?>());
+                }
+                else if (_graph.IsReference(element) && !ReferenceGraph.IsReferenceType(meta.paramType))
+                {
+                    _graph.Remove(element);
+                }
+            }
+
+            Record(ChangeKind.Meta, element, old == null ? null : rollback => SetMeta(old.Value, rollback.Map(element)));
+            return meta;
+        }
+
+        /// <summary>
+        /// The native side reads one whole structure for a single value and whole structures for every list entry
+        /// </summary>
+        private static void CheckLength(Array values, int components, bool isList)
+        {
+            if (isList ? values.Length % components != 0 : values.Length != components)
+                throw new ArgumentException("The buffer does not hold whole values of the given type.", nameof(values));
+        }
+
+        private void SetNative(uint paramId, Array data, uint type, int listLength)
+        {
+            var undo = CaptureValue(paramId);
+            var handle = GCHandle.Alloc(data, GCHandleType.Pinned);
+
+            try
+            {
+                long start = VRMatStats.Begin();
+                bool isOK = VRMatAPI.DataContainer_SetValue(Dysplay, paramId, handle.AddrOfPinnedObject(), type, listLength) >= 1;
+                VRMatStats.End(VRMatExport.SetValue, start);
+                if (!isOK)
+                    throw new Exception($"VR Exception! The value of parameter {paramId} was not set correctly.");
+            }
+            finally
+            {
+                handle.Free();
+            }
+
+            // a texture slot holding a constant color or float references nothing, the string overload sets the names itself
+            if ((type & (uint)Rdt.String) == 0)
+                _graph?.SetTargets(paramId, Array.Empty<string?>());
+
+            Record(ChangeKind.Value, paramId, undo);
+        }
+
+        private void SetPacked(IReadOnlyList<uint> paramIds, Array packed, int stride, uint type)
+        {
+            var handle = GCHandle.Alloc(packed, GCHandleType.Pinned);
+
+            try
+            {
+                var data = handle.AddrOfPinnedObject();
+                for (int i = 0; i < paramIds.Count; i++)
+                {
+                    var undo = CaptureValue(paramIds[i]);
+
+                    long start = VRMatStats.Begin();
+                    bool isOK = VRMatAPI.DataContainer_SetValue(Dysplay, paramIds[i], data + i * stride, type, 0) >= 1;
+                    VRMatStats.End(VRMatExport.SetValue, start);
+                    if (!isOK)
+                        throw new Exception($"VR Exception! The value of parameter {paramIds[i]} was not set correctly.");
+
+                    _graph?.SetTargets(paramIds[i], Array.Empty<string?>());
+                    Record(ChangeKind.Value, paramIds[i], undo);
+                }
+            }
+            finally
+            {
+                handle.Free();
+            }
+        }
+
+        internal MetaNative GetMetaNative(uint element, MetaCategories mask)
+        {
+            var meta = new MetaNative { mask = (uint)mask };
+            long start = VRMatStats.Begin();
+            bool isOK = VRMatAPI.DataContainer_GetMeta(Dysplay, element, ref meta) >= 1;
+            VRMatStats.End(VRMatExport.GetMeta, start);
 
             if (!isOK)
                 throw new Exception("VR Exception! The get meta was not load correctly.");
 
             return meta;
         }
+
+        private void SetMetaNative(uint element, ref MetaNative meta)
+        {
+            long start = VRMatStats.Begin();
+            bool isOK = VRMatAPI.DataContainer_SetMeta(Dysplay, element, ref meta) >= 1;
+            VRMatStats.End(VRMatExport.SetMeta, start);
+
+            if (!isOK)
+                throw new Exception("VR Exception! The set meta was not load correctly.");
+        }
+
+        /// <summary>
+        /// Adds a copy of a plugin of another container under the given name, with all its parameters, meta and values
+        /// </summary>
+        /// <param name="paramMap">If given, receives the id of every copied parameter keyed by its source id</param>
+        private uint CopyPlugin(MediatorVRMatAPI source, uint sourcePluginId, string name, Dictionary<uint, uint>? paramMap = null)
+        {
+            uint pluginId = AddPlugin(name, source, sourcePluginId);
+            CopyParameters(source, sourcePluginId, pluginId, paramMap, null);
+            return pluginId;
+        }
+
+        /// <summary>
+        /// Adds an empty plugin with the type, class and version of a plugin of another container
+        /// </summary>
+        private uint AddPlugin(string name, MediatorVRMatAPI source, uint sourcePluginId)
+        {
+            var meta = source.GetMetaNative(sourcePluginId, MetaCategories.Plugin);
+            uint pluginId = AddPlugin(name, _strings.FromNative(meta.pluginType) ?? "", _strings.FromNative(meta.pluginClass) ?? "");
+
+            meta.mask = (uint)MetaCategories.PluginVersion;
+            SetMetaNative(pluginId, ref meta);
+            return pluginId;
+        }
+
+        /// <param name="renames">If given, plugin names in reference values are replaced with the mapped names</param>
+        private void CopyParameters(MediatorVRMatAPI source, uint sourcePluginId, uint pluginId, Dictionary<uint, uint>? paramMap, Dictionary<string, string>? renames)
+        {
+            var paramIds = source.ParamIds(sourcePluginId);
+            var values = source.TryGetValues(paramIds);
+
+            for (int i = 0; i < paramIds.Count; i++)
+            {
+                var paramMeta = source.GetMetaNative(paramIds[i], MetaCategories.Param);
+                var paramType = _strings.FromNative(paramMeta.paramType) ?? "";
+                uint paramId = AddParameter(pluginId, _strings.FromNative(paramMeta.paramName) ?? "", paramType, paramMeta.paramCustom);
+                if (paramMap != null)
+                    paramMap[paramIds[i]] = paramId;
+
+                paramMeta.mask = (uint)MetaCategories.ParamFilePath;
+                SetMetaNative(paramId, ref paramMeta);
+
+                // unset values and empty single values such as an unset texture slot stay unset, an empty list is copied as one
+                var value = values[i];
+                if (value != null && (value.Count > 0 || value.IsList))
+                {
+                    if (renames?.Count > 0 && value.Strings != null && ReferenceGraph.IsReferenceType(paramType))
+                    {
+                        for (int j = 0; j < value.Strings.Length; j++)
+                        {
+                            if (value.Strings[j] is string target && renames.TryGetValue(target, out var renamed))
+                                value.Strings[j] = renamed;
+                        }
+                    }
+
+                    value.ParamId = paramId;
+                    value.PluginId = pluginId;
+                    SetValue(value);
+                }
+            }
+        }
+
+        /// <summary>
+        /// The given plugins and every plugin they reference, directly or through other plugins
+        /// </summary>
+        private static List<uint> Reachable(MediatorVRMatAPI source, IEnumerable<uint> roots)
+        {
+            var seen = new HashSet<uint>();
+            var result = new List<uint>();
+            var pending = new Queue<uint>(roots);
+
+            while (pending.Count > 0)
+            {
+                uint pluginId = pending.Dequeue();
+                if (!seen.Add(pluginId))
+                    continue;
+
+                result.Add(pluginId);
+                foreach (var target in source.Graph.ReferencesOf(pluginId))
+                    pending.Enqueue(target);
+            }
+
+            return result;
+        }
+
+        private bool Recording => _transaction != null && !_replaying;
+
+        private void Record(ChangeKind kind, uint elementId, Action<Rollback>? undo)
+        {
+            if (_replaying)
+                return;
+
+            if (_transaction == null)
+            {
+                Committed?.Invoke(new[] { new Change(kind, elementId) });
+                return;
+            }
+
+            _transaction.Add(new Change(kind, elementId));
+            if (undo != null)
+                _transaction.Undo.Add(undo);
+        }
+
+        /// <summary>
+        /// Saves what is needed to bring back the value of a parameter before it is set
+        /// </summary>
+        private Action<Rollback>? CaptureValue(uint paramId)
+        {
+            // parameters created in this transaction are simply removed on rollback
+            if (!Recording || _transaction!.Added.Contains(paramId))
+                return null;
+
+            var old = TryGetValue(paramId);
+            if (old != null && (old.Count > 0 || old.IsList))
+            {
+                return rollback =>
+                {
+                    old.ParamId = rollback.Map(paramId);
+                    SetValue(old);
+                };
+            }
+
+            // there is no export to clear a value, a parameter that had none is replaced with a fresh one
+            var restore = CaptureParameter(paramId, true);
+            return rollback =>
+            {
+                RemoveElement(rollback.Map(paramId));
+                restore(rollback);
+            };
+        }
+
+        private ParamValue? TryGetValue(uint paramId)
+        {
+            return TryGetValues(new[] { paramId })[0];
+        }
+
+        /// <summary>
+        /// Saves what is needed to add an element back after it is removed
+        /// </summary>
+        private Action<Rollback> CaptureRemoval(uint elementId)
+        {
+            bool visible = !_transaction!.Added.Contains(elementId);
+
+            if (Index.IsPlugin(elementId))
+            {
+                var name = Index.PluginName(elementId)!;
+                var saved = new Dictionary<uint, uint>();
+
+                _scratch ??= new MediatorVRMatAPI(_file, false);
+                uint savedId = _scratch.CopyPlugin(this, elementId, name, saved);
+                var scratch = _scratch;
+
+                return rollback =>
+                {
+                    var restored = new Dictionary<uint, uint>();
+                    uint pluginId = CopyPlugin(scratch, savedId, name, restored);
+
+                    rollback.Restored(elementId, pluginId, visible);
+                    foreach (var pair in saved)
+                        rollback.Restored(pair.Key, restored[pair.Value], false);
+                };
+            }
+
+            return CaptureParameter(elementId, visible);
+        }
+
+        /// <summary>
+        /// Saves the owner, meta and value of a parameter, the returned step adds it back under a new id
+        /// </summary>
+        private Action<Rollback> CaptureParameter(uint elementId, bool visible)
+        {
+            var meta = ToMeta(GetMetaNative(elementId, MetaCategories.Param));
+            var value = TryGetValue(elementId);
+            uint owner = value?.PluginId ?? OwnerOf(elementId);
+
+            return rollback =>
+            {
+                uint paramId = AddParameter(rollback.Map(owner), meta.paramName ?? "", meta.paramType ?? "", meta.paramCustom);
+
+                var filePath = new Meta { mask = (uint)MetaCategories.ParamFilePath, paramFilePath = meta.paramFilePath };
+                SetMeta(filePath, paramId);
+
+                if (value != null && (value.Count > 0 || value.IsList))
+                {
+                    value.ParamId = paramId;
+                    SetValue(value);
+                }
+
+                rollback.Restored(elementId, paramId, visible);
+            };
+        }
+
+        private void DisposeScratch()
+        {
+            _scratch?.Dispose();
+            _scratch = null;
+        }
+
+        private Meta ToMeta(in MetaNative meta)
+        {
+            return new Meta
+            {
+                mask = meta.mask,
+                version = meta.version,
+                category = _strings.FromNative(meta.category)!,
+                preview = Marshal.PtrToStringAnsi(meta.preview)!,
+                tag = _strings.FromNative(meta.tag)!,
+                fileName = _strings.FromNative(meta.fileName)!,
+                pluginName = _strings.FromNative(meta.pluginName)!,
+                pluginType = _strings.FromNative(meta.pluginType)!,
+                pluginClass = _strings.FromNative(meta.pluginClass)!,
+                pluginVersion = meta.pluginVersion,
+                paramName = _strings.FromNative(meta.paramName)!,
+                paramType = _strings.FromNative(meta.paramType)!,
+                paramCustom = meta.paramCustom,
+                paramFilePath = meta.paramFilePath,
+            };
+        }
+
+        private NameIndex BuildIndex()
+        {
+            long start = VRMatStats.Begin();
+            var index = new NameIndex();
+            foreach (var pluginId in PluginIds())
+                index.AddPlugin(pluginId, _strings.FromNative(GetMetaNative(pluginId, MetaCategories.PluginName).pluginName) ?? "");
+
+            VRMatStats.EndSpan("index", _file, start);
+            return index;
+        }
+
+        private ReferenceGraph BuildGraph()
+        {
+            long start = VRMatStats.Begin();
+            var graph = new ReferenceGraph(Index);
+            var references = new List<uint>();
+
+            foreach (var pluginId in Index.PluginIds.ToList())
+            {
+                foreach (var paramId in ParamIds(pluginId))
+                {
+                    if (ReferenceGraph.IsReferenceType(_strings.FromNative(GetMetaNative(paramId, MetaCategories.ParamType).paramType)))
+                    {
+                        graph.AddParameter(pluginId, paramId);
+                        references.Add(paramId);
+                    }
+                }
+            }
+
+            // a reference that was added but never set has no value and no targets yet
+            foreach (var value in TryGetValues(references))
+            {
+                if (value?.Rdt == Rdt.String)
+                    graph.SetTargets(value.ParamId, value.Strings!);
+            }
+
+            VRMatStats.EndSpan("graph", _file, start);
+            return graph;
+        }
+
+        private void IndexParameters(uint pluginId)
+        {
+            var index = Index;
+            index.AddParameters(pluginId);
+
+            foreach (var paramId in ParamIds(pluginId))
+                index.AddParameter(pluginId, paramId, _strings.FromNative(GetMetaNative(paramId, MetaCategories.ParamName).paramName) ?? "");
+        }
+
+        /// <summary>
+        /// The plugin of a parameter. Plugins whose parameters are not indexed yet are indexed until the owner is found
+        /// </summary>
+        private uint OwnerOf(uint paramId)
+        {
+            uint owner = Index.PluginOf(paramId);
+            if (owner != 0)
+                return owner;
+
+            foreach (var pluginId in Index.PluginIds.ToList())
+            {
+                if (Index.HasParameters(pluginId))
+                    continue;
+
+                IndexParameters(pluginId);
+                if (Index.PluginOf(paramId) == pluginId)
+                    return pluginId;
+            }
+
+            throw new Exception($"VR Exception! The plugin of parameter {paramId} was not found.");
+        }
+
+        private List<uint> CollectIds(uint pluginId)
+        {
+            var collector = new IdCollector { Params = pluginId != 0 };
+            var handle = GCHandle.Alloc(collector);
+
+            try
+            {
+                CollectIds(pluginId, collector, GCHandle.ToIntPtr(handle));
+            }
+            finally
+            {
+                handle.Free();
+            }
+
+            return collector.Ids;
+        }
+
+        /// <summary>
+        /// Refills the collector's id list, userData must be a handle to the collector
+        /// </summary>
+        private void CollectIds(uint pluginId, IdCollector collector, IntPtr userData)
+        {
+            collector.Ids.Clear();
+
+            long start = VRMatStats.Begin();
+            var it = VRMatAPI.DataContainer_Iterator_Create(Dysplay, pluginId, IntPtr.Zero, _idCallback, userData);
+            VRMatStats.End(VRMatExport.IteratorCreate, start);
+
+            if (it == IntPtr.Zero)
+                return;
+
+            try
+            {
+                while (Increment(it, userData))
+                {
+                }
+            }
+            finally
+            {
+                start = VRMatStats.Begin();
+                VRMatAPI.DataContainer_Iterator_Destroy(it);
+                VRMatStats.End(VRMatExport.IteratorDestroy, start);
+            }
+        }
+
+        private static bool Increment(IntPtr it, IntPtr userData)
+        {
+            long start = VRMatStats.Begin();
+            bool more = VRMatAPI.DataContainer_Iterator_Increment(it, _idCallback, userData) != 0;
+            VRMatStats.End(VRMatExport.IteratorIncrement, start);
+            return more;
+        }
+
+        private bool VisitFileOrder(ElementVisitor visitor, FileOrder order)
+        {
+            var index = Index;
+
+            foreach (var pluginId in order.Plugins)
+            {
+                if (!index.IsPlugin(pluginId))
+                    continue;
+
+                if (!visitor(pluginId, 0))
+                    return false;
+
+                foreach (var paramId in order.Params[pluginId])
+                {
+                    if (index.IsParameter(paramId) && !visitor(pluginId, paramId))
+                        return false;
+                }
+            }
+
+            return true;
+        }
+
+        /// <summary>
+        /// Scans the source document for the plugin and parameter names and resolves them through the name index.
+        /// Elements the document does not mention follow in container order
+        /// </summary>
+        private FileOrder BuildFileOrder()
+        {
+            long start = VRMatStats.Begin();
+            var order = new FileOrder();
+            var scanner = new VRMatScanner();
+            uint current = 0;
+
+            scanner.OnPlugin = plugin =>
+            {
+                current = GetElementId(0, plugin.Name);
+                if (current != 0)
+                    order.AddPlugin(current);
+
+                return true;
+            };
+
+            scanner.OnParameter = parameter =>
+            {
+                if (current != 0 && GetElementId(current, parameter.Name) is uint paramId && paramId != 0)
+                    order.AddParameter(current, paramId);
+
+                return true;
+            };
+
+            if (_buffer != null)
+                scanner.ScanBuffer(_buffer);
+            else if (File.Exists(_file))
+                scanner.ScanFile(_file);
+
+            foreach (var pluginId in PluginIds())
+            {
+                order.AddPlugin(pluginId);
+
+                if (!Index.HasParameters(pluginId))
+                    IndexParameters(pluginId);
+
+                foreach (var paramId in ParamIds(pluginId))
+                    order.AddParameter(pluginId, paramId);
+            }
+
+            VRMatStats.EndSpan("file order", _file, start);
+            return order;
+        }
+
+        private static void OnId(IntPtr value, IntPtr userData)
+        {
+            var collector = (IdCollector)GCHandle.FromIntPtr(userData).Target!;
+
+            // only the id is needed - reading it directly avoids the boxed copy Marshal.PtrToStructure makes per call
+            uint id = (uint)Marshal.ReadInt32(value, collector.Params ? 4 : 0);
+
+            // the iterator reports its current element, so guard against the same element being reported twice
+            if (id != 0 && (collector.Ids.Count == 0 || collector.Ids[^1] != id))
+                collector.Ids.Add(id);
+        }
+
+        private static void OnValue(IntPtr value, IntPtr userData)
+        {
+            var collector = (ValueCollector)GCHandle.FromIntPtr(userData).Target!;
+            var data = ReadValueData(value);
+
+            // string lists call back once per entry, the first entry creates the value
+            if (collector.Current != null && data.rdt == Rdt.String && data.listIndex > 0)
+                collector.Current.AppendString(data, collector.Strings);
+            else
+                collector.Current = ParamValue.FromNative(data, collector.Strings);
+        }
+
+        /// <summary>
+        /// Reads ValueData field by field at its packed offsets, Marshal.PtrToStructure would box a copy on every callback
+        /// </summary>
+        private static ValueData ReadValueData(IntPtr value)
+        {
+            return new ValueData
+            {
+                pluginId = (uint)Marshal.ReadInt32(value, 0),
+                paramId = (uint)Marshal.ReadInt32(value, 4),
+                listCount = (uint)Marshal.ReadInt32(value, 8),
+                listIndex = (uint)Marshal.ReadInt32(value, 12),
+                isList = (uint)Marshal.ReadInt32(value, 16),
+                components = (uint)Marshal.ReadInt32(value, 20),
+                rdt = (Rdt)Marshal.ReadInt32(value, 24),
+                stdt = (Stdt)Marshal.ReadInt32(value, 28),
+                sqdt = (Sqdt)Marshal.ReadInt32(value, 32),
+                data = Marshal.ReadIntPtr(value, 36),
+            };
+        }
+
+        private sealed class ValueCollector
+        {
+            public ParamValue? Current;
+            public StringPool? Strings;
+        }
+
+        private sealed class IdCollector
+        {
+            public bool Params;
+            public readonly List<uint> Ids = new();
+        }
+
         protected virtual void Dispose(bool disposing)
         {
             if (disposing)
             {
                 //   managed resources
-
+                DisposeScratch();
             }
 
             //   unmanaged resources
             if (Dysplay != IntPtr.Zero)
             {
+                long start = VRMatStats.Begin();
                 VRMatAPI.DataContainer_Destroy(Dysplay);
+                VRMatStats.End(VRMatExport.Destroy, start);
                 Dysplay = IntPtr.Zero;
             }
         }
 
         protected virtual bool Open()
         {
-            Dysplay = VRMatAPI.DataContainer_Create();
+            Create();
+
+            long start = VRMatStats.Begin();
             bool isOpen = VRMatAPI.DataContainer_Open(Dysplay, _file) >= 1;
+            VRMatStats.End(VRMatExport.Open, start, "open", _file);
 
             if (!isOpen)
                 throw new Exception("VR Exception! The file was not load correctly.");
 
+            if (VRMatStats.Enabled)
+                VRMatStats.AddBytesParsed(new FileInfo(_file).Length);
+
             return isOpen;
         }
+
+        private void Create()
+        {
+            long start = VRMatStats.Begin();
+            Dysplay = VRMatAPI.DataContainer_Create();
+            VRMatStats.End(VRMatExport.Create, start);
+        }
     }
 
 
@@ -0,0 +1,207 @@
+﻿namespace WinFormsChaosApp
+{
+    /// <summary>
+    /// Hashed plugin and parameter name lookup for a single data container.
+    /// Kept current by MediatorVRMatAPI on every add, remove and rename that goes through it
+    /// </summary>
+    public sealed class NameIndex
+    {
+        private readonly Dictionary<string, uint> _plugins = new(StringComparer.Ordinal);
+        private readonly Dictionary<uint, string> _pluginNames = new();
+
+        // ordinal order keeps every "/"-separated sub-path in one contiguous range
+        private readonly SortedSet<string> _sortedNames = new(StringComparer.Ordinal);
+
+        // parameter names are filled in per plugin on first lookup
+        private readonly Dictionary<uint, Dictionary<string, uint>> _params = new();
+        private readonly Dictionary<uint, (uint PluginId, string Name)> _paramOwners = new();
+
+        // vrmat.dll leaves name uniqueness to the caller - further plugins sharing a name wait here
+        // until the plugin that owns the name in _plugins goes away
+        private readonly Dictionary<string, List<uint>> _duplicates = new(StringComparer.Ordinal);
+
+        // the next suffix to try for a given base name, so repeated requests do not re-probe
+        private readonly Dictionary<string, int> _suffixes = new(StringComparer.Ordinal);
+
+        public int PluginCount => _plugins.Count;
+
+        public IEnumerable<uint> PluginIds => _pluginNames.Keys;
+
+        public bool IsPlugin(uint id) => _pluginNames.ContainsKey(id);
+
+        public bool IsParameter(uint id) => _paramOwners.ContainsKey(id);
+
+        public bool HasParameters(uint pluginId) => _params.ContainsKey(pluginId);
+
+        public string? PluginName(uint pluginId)
+        {
+            return _pluginNames.TryGetValue(pluginId, out var name) ? name : null;
+        }
+
+        public uint PluginOf(uint paramId)
+        {
+            return _paramOwners.TryGetValue(paramId, out var owner) ? owner.PluginId : 0;
+        }
+
+        public uint FindPlugin(string name)
+        {
+            return _plugins.TryGetValue(name, out var id) ? id : 0;
+        }
+
+        public uint FindParameter(uint pluginId, string name)
+        {
+            return _params.TryGetValue(pluginId, out var names) && names.TryGetValue(name, out var id) ? id : 0;
+        }
+
+        public void AddPlugin(uint pluginId, string name)
+        {
+            _pluginNames[pluginId] = name;
+
+            if (_plugins.TryAdd(name, pluginId))
+            {
+                _sortedNames.Add(name);
+            }
+            else if (_plugins[name] != pluginId)
+            {
+                if (!_duplicates.TryGetValue(name, out var ids))
+                    _duplicates[name] = ids = new List<uint>();
+
+                ids.Add(pluginId);
+            }
+        }
+
+        /// <summary>
+        /// Marks the parameters of a plugin as indexed, even if it has none
+        /// </summary>
+        public void AddParameters(uint pluginId)
+        {
+            if (!_params.ContainsKey(pluginId))
+                _params[pluginId] = new Dictionary<string, uint>(StringComparer.Ordinal);
+        }
+
+        public void AddParameter(uint pluginId, uint paramId, string name)
+        {
+            // a parameter added to a plugin that was never looked up stays unindexed until the plugin is
+            if (!_params.TryGetValue(pluginId, out var names))
+                return;
+
+            names[name] = paramId;
+            _paramOwners[paramId] = (pluginId, name);
+        }
+
+        public void RenameParameter(uint paramId, string name)
+        {
+            if (!_paramOwners.TryGetValue(paramId, out var owner))
+                return;
+
+            RemoveParameterName(owner.PluginId, owner.Name, paramId);
+            AddParameter(owner.PluginId, paramId, name);
+        }
+
+        public void RenamePlugin(uint pluginId, string name)
+        {
+            if (!_pluginNames.TryGetValue(pluginId, out var oldName))
+                return;
+
+            RemovePluginName(oldName, pluginId);
+            AddPlugin(pluginId, name);
+        }
+
+        public void Remove(uint elementId)
+        {
+            if (_pluginNames.Remove(elementId, out var name))
+            {
+                RemovePluginName(name, elementId);
+
+                if (_params.Remove(elementId, out var names))
+                {
+                    foreach (var paramId in names.Values)
+                        _paramOwners.Remove(paramId);
+                }
+            }
+            else if (_paramOwners.Remove(elementId, out var owner))
+            {
+                RemoveParameterName(owner.PluginId, owner.Name, elementId);
+            }
+        }
+
+        private void RemovePluginName(string name, uint pluginId)
+        {
+            _duplicates.TryGetValue(name, out var ids);
+
+            if (_plugins.TryGetValue(name, out var owner) && owner == pluginId)
+            {
+                if (ids == null)
+                {
+                    _plugins.Remove(name);
+                    _sortedNames.Remove(name);
+                    return;
+                }
+
+                // the name passes on to the oldest remaining plugin with it
+                _plugins[name] = ids[0];
+                ids.RemoveAt(0);
+            }
+            else
+            {
+                ids?.Remove(pluginId);
+            }
+
+            if (ids?.Count == 0)
+                _duplicates.Remove(name);
+        }
+
+        private void RemoveParameterName(uint pluginId, string name, uint paramId)
+        {
+            if (_params.TryGetValue(pluginId, out var names) && names.TryGetValue(name, out var id) && id == paramId)
+                names.Remove(name);
+        }
+
+        /// <summary>
+        /// Returns the ids of all plugins whose name is nested under the given "/"-separated path
+        /// </summary>
+        public IEnumerable<uint> FindPluginsUnder(string path)
+        {
+            string prefix = path.EndsWith('/') ? path : path + "/";
+
+            // '0' is the character right after '/', so the view ends with the last name starting with prefix
+            string upper = prefix.Substring(0, prefix.Length - 1) + "0";
+
+            foreach (var name in _sortedNames.GetViewBetween(prefix, upper))
+            {
+                if (!name.StartsWith(prefix, StringComparison.Ordinal))
+                    continue;
+
+                yield return _plugins[name];
+
+                if (_duplicates.TryGetValue(name, out var ids))
+                {
+                    foreach (var id in ids)
+                        yield return id;
+                }
+            }
+        }
+
+        /// <summary>
+        /// Returns the name itself if it is free, otherwise the name with the next free "#N" suffix
+        /// </summary>
+        public string UniqueName(string name)
+        {
+            if (!_plugins.ContainsKey(name))
+                return name;
+
+            _suffixes.TryGetValue(name, out int suffix);
+
+            string candidate;
+            do
+            {
+                suffix++;
+                candidate = $"{name}#{suffix}";
+            }
+            while (_plugins.ContainsKey(candidate));
+
+            _suffixes[name] = suffix;
+            return candidate;
+        }
+    }
+}
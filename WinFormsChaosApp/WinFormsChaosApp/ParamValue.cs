@@ -0,0 +1,100 @@
+﻿using System.Runtime.InteropServices;
+using static WinFormsChaosApp.VRMatAPI;
+
+namespace WinFormsChaosApp
+{
+    /// <summary>
+    /// A managed copy of a parameter value.
+    /// The native ValueData pointer is only valid inside the callback, so the data is copied out while it is alive
+    /// </summary>
+    public sealed class ParamValue
+    {
+        public uint PluginId { get; set; }
+        public uint ParamId { get; set; }
+        public Rdt Rdt { get; set; }
+        public Stdt Stdt { get; set; } = Stdt.Single;
+        public Sqdt Sqdt { get; set; } = Sqdt.Single;
+
+        public bool IsList => Sqdt == Sqdt.List;
+
+        /// <summary>
+        /// The number of list entries, or 1 for single values
+        /// </summary>
+        public int Count { get; set; }
+
+        /// <summary>
+        /// The number of floats per entry - 1 for Single, 3 for Array3, etc.
+        /// </summary>
+        public int Components => ComponentCount(Stdt);
+
+        public float[]? Floats { get; set; }
+        public int[]? Ints { get; set; }
+        public string?[]? Strings { get; set; }
+
+        /// <summary>
+        /// The bitwise-OR of Rdt, Stdt and Sqdt as expected by DataContainer_SetValue
+        /// </summary>
+        public uint Type => (uint)Rdt | (uint)Stdt | (uint)Sqdt;
+
+        public static int ComponentCount(Stdt stdt)
+        {
+            switch (stdt)
+            {
+                case Stdt.Array3: return 3;
+                case Stdt.Array4: return 4;
+                case Stdt.Array9: return 9;
+                case Stdt.Array12: return 12;
+                default: return 1;
+            }
+        }
+
+        internal static ParamValue FromNative(in ValueData value, StringPool? strings = null)
+        {
+            var result = new ParamValue
+            {
+                PluginId = value.pluginId,
+                ParamId = value.paramId,
+                Rdt = value.rdt,
+                Stdt = value.stdt == Stdt.None ? Stdt.Single : value.stdt,
+                Sqdt = value.isList != 0 ? Sqdt.List : Sqdt.Single,
+            };
+
+            int count = result.IsList ? (int)value.listCount : 1;
+            if (value.data == IntPtr.Zero)
+                count = 0;
+
+            result.Count = count;
+
+            switch (value.rdt)
+            {
+                case Rdt.Float:
+                    result.Floats = new float[count * result.Components];
+                    if (result.Floats.Length > 0)
+                        Marshal.Copy(value.data, result.Floats, 0, result.Floats.Length);
+                    break;
+
+                case Rdt.Int:
+                    result.Ints = new int[count];
+                    if (count > 0)
+                        Marshal.Copy(value.data, result.Ints, 0, count);
+                    break;
+
+                case Rdt.String:
+                    // string lists are reported one entry per callback, see AppendString()
+                    result.Strings = new string?[count];
+                    if (count > 0)
+                        result.AppendString(value, strings);
+                    break;
+            }
+
+            return result;
+        }
+
+        internal void AppendString(in ValueData value, StringPool? strings = null)
+        {
+            int index = IsList ? (int)value.listIndex : 0;
+            if (Strings != null && index < Strings.Length)
+                Strings[index] = strings != null ? strings.Share(value.data) : Marshal.PtrToStringAnsi(value.data);
+        }
+    }
+}
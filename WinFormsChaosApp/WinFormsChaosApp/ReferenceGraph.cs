@@ -0,0 +1,215 @@
+﻿namespace WinFormsChaosApp
+{
+    /// <summary>
+    /// Forward and reverse plugin references of a single data container.
+    /// A reference is a "plugin" (or texture) parameter whose string value(s) name another plugin.
+    /// Reverse references are keyed by the referenced name, so a dangling reference resolves as soon as a plugin with that name appears
+    /// </summary>
+    public sealed class ReferenceGraph
+    {
+        private readonly NameIndex _index;
+
+        // every reference parameter with its owner and the names it currently holds
+        private readonly Dictionary<uint, ParamRefs> _params = new();
+
+        // reference parameters owned by each plugin
+        private readonly Dictionary<uint, HashSet<uint>> _pluginParams = new();
+
+        // reference parameters naming each plugin
+        private readonly Dictionary<string, HashSet<uint>> _referrers = new(StringComparer.Ordinal);
+
+        public ReferenceGraph(NameIndex index)
+        {
+            _index = index;
+        }
+
+        /// <summary>
+        /// Whether a parameter of the given meta type holds plugin names.
+        /// Covers "plugin" and the legacy texture types such as "texture", "float texture", "acolor texture"
+        /// </summary>
+        public static bool IsReferenceType(string? paramType)
+        {
+            if (string.IsNullOrEmpty(paramType))
+                return false;
+
+            return paramType == "plugin" || paramType == "texture" || paramType.EndsWith(" texture", StringComparison.Ordinal);
+        }
+
+        public bool IsReference(uint paramId) => _params.ContainsKey(paramId);
+
+        public void AddParameter(uint pluginId, uint paramId)
+        {
+            if (_params.ContainsKey(paramId))
+                return;
+
+            _params[paramId] = new ParamRefs(pluginId);
+
+            if (!_pluginParams.TryGetValue(pluginId, out var owned))
+                _pluginParams[pluginId] = owned = new HashSet<uint>();
+
+            owned.Add(paramId);
+        }
+
+        /// <summary>
+        /// Replaces the names held by a reference parameter. Does nothing for parameters that are not references
+        /// </summary>
+        public void SetTargets(uint paramId, IEnumerable<string?> targets)
+        {
+            if (!_params.TryGetValue(paramId, out var refs))
+                return;
+
+            Unlink(paramId, refs);
+
+            refs.Targets = targets.Where(t => !string.IsNullOrEmpty(t)).Select(t => t!).Distinct(StringComparer.Ordinal).ToArray();
+            foreach (var target in refs.Targets)
+            {
+                if (!_referrers.TryGetValue(target, out var referrers))
+                    _referrers[target] = referrers = new HashSet<uint>();
+
+                referrers.Add(paramId);
+            }
+        }
+
+        /// <summary>
+        /// Forgets a plugin with all of its reference parameters, or a single reference parameter.
+        /// References to a removed plugin are kept and become dangling
+        /// </summary>
+        public void Remove(uint elementId)
+        {
+            if (_pluginParams.Remove(elementId, out var owned))
+            {
+                foreach (var paramId in owned)
+                {
+                    Unlink(paramId, _params[paramId]);
+                    _params.Remove(paramId);
+                }
+            }
+            else if (_params.Remove(elementId, out var refs))
+            {
+                Unlink(elementId, refs);
+                _pluginParams[refs.PluginId].Remove(elementId);
+            }
+        }
+
+        public IReadOnlyList<string> TargetsOf(uint paramId)
+        {
+            return _params.TryGetValue(paramId, out var refs) ? refs.Targets : Array.Empty<string>();
+        }
+
+        /// <summary>
+        /// The reference parameters naming the given plugin name
+        /// </summary>
+        public IReadOnlyCollection<uint> ReferrersOf(string pluginName)
+        {
+            return _referrers.TryGetValue(pluginName, out var referrers) ? referrers : Array.Empty<uint>();
+        }
+
+        /// <summary>
+        /// The existing plugins the given plugin references
+        /// </summary>
+        public IEnumerable<uint> ReferencesOf(uint pluginId)
+        {
+            if (!_pluginParams.TryGetValue(pluginId, out var owned))
+                return Array.Empty<uint>();
+
+            var result = new HashSet<uint>();
+            foreach (var paramId in owned)
+            {
+                foreach (var target in _params[paramId].Targets)
+                {
+                    uint targetId = _index.FindPlugin(target);
+                    if (targetId != 0)
+                        result.Add(targetId);
+                }
+            }
+
+            return result;
+        }
+
+        /// <summary>
+        /// The plugins that reference the given plugin
+        /// </summary>
+        public IEnumerable<uint> ReferencedBy(uint pluginId)
+        {
+            var name = _index.PluginName(pluginId);
+            if (name == null)
+                return Array.Empty<uint>();
+
+            return ReferrersOf(name).Select(paramId => _params[paramId].PluginId).Distinct();
+        }
+
+        /// <summary>
+        /// All references to plugin names that do not exist in the container
+        /// </summary>
+        public IEnumerable<(uint ParamId, string Target)> Dangling()
+        {
+            foreach (var pair in _referrers)
+            {
+                if (_index.FindPlugin(pair.Key) != 0)
+                    continue;
+
+                foreach (var paramId in pair.Value)
+                    yield return (paramId, pair.Key);
+            }
+        }
+
+        /// <summary>
+        /// All plugins ordered so that every plugin comes after the plugins it references.
+        /// Plugins that are part of a reference cycle are appended at the end
+        /// </summary>
+        public List<uint> TopologicalOrder()
+        {
+            var pending = new Dictionary<uint, int>();
+            var ready = new Queue<uint>();
+
+            foreach (var pluginId in _index.PluginIds)
+            {
+                int count = ReferencesOf(pluginId).Count(id => id != pluginId);
+                pending[pluginId] = count;
+
+                if (count == 0)
+                    ready.Enqueue(pluginId);
+            }
+
+            var order = new List<uint>(pending.Count);
+            while (ready.Count > 0)
+            {
+                uint pluginId = ready.Dequeue();
+                order.Add(pluginId);
+
+                foreach (var dependent in ReferencedBy(pluginId))
+                {
+                    if (dependent != pluginId && pending.ContainsKey(dependent) && --pending[dependent] == 0)
+                        ready.Enqueue(dependent);
+                }
+            }
+
+            if (order.Count < pending.Count)
+                order.AddRange(pending.Where(p => p.Value > 0).Select(p => p.Key));
+
+            return order;
+        }
+
+        private void Unlink(uint paramId, ParamRefs refs)
+        {
+            foreach (var target in refs.Targets)
+            {
+                if (_referrers.TryGetValue(target, out var referrers) && referrers.Remove(paramId) && referrers.Count == 0)
+                    _referrers.Remove(target);
+            }
+
+            refs.Targets = Array.Empty<string>();
+        }
+
+        private sealed class ParamRefs
+        {
+            public readonly uint PluginId;
+            public string[] Targets = Array.Empty<string>();
+
+            public ParamRefs(uint pluginId)
+            {
+                PluginId = pluginId;
+            }
+        }
+    }
+}
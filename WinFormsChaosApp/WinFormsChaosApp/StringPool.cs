@@ -0,0 +1,73 @@
+﻿using System.Runtime.InteropServices;
+
+namespace WinFormsChaosApp
+{
+    /// <summary>
+    /// Interns the strings copied out of a data container.
+    /// Type names such as "float" or "plugin" and plugin paths repeat hundreds of times per file,
+    /// the pool keeps a single managed instance of each one for the lifetime of the mediator
+    /// </summary>
+    public sealed class StringPool
+    {
+        private readonly Dictionary<string, string> _strings = new(StringComparer.Ordinal);
+
+        /// <summary>
+        /// The number of distinct strings held by the pool
+        /// </summary>
+        public int Count => _strings.Count;
+
+        /// <summary>
+        /// How many strings were resolved to an already pooled instance
+        /// </summary>
+        public long Hits { get; private set; }
+
+        /// <summary>
+        /// The number of characters held by the pool
+        /// </summary>
+        public long Chars { get; private set; }
+
+        public string Intern(string value)
+        {
+            if (_strings.TryGetValue(value, out var pooled))
+            {
+                Hits++;
+                return pooled;
+            }
+
+            _strings.Add(value, value);
+            Chars += value.Length;
+            return value;
+        }
+
+        /// <summary>
+        /// Copies a null-terminated string owned by the container and interns it
+        /// </summary>
+        public string? FromNative(IntPtr value)
+        {
+            var result = Marshal.PtrToStringAnsi(value);
+            return result == null ? null : Intern(result);
+        }
+
+        /// <summary>
+        /// Copies a null-terminated string owned by the container and returns the pooled instance if there is one,
+        /// without adding the string to the pool. Used for values - a reference to a plugin shares the instance of its name,
+        /// while file paths and user strings do not grow the pool
+        /// </summary>
+        public string? Share(IntPtr value)
+        {
+            var result = Marshal.PtrToStringAnsi(value);
+            if (result == null || !_strings.TryGetValue(result, out var pooled))
+                return result;
+
+            Hits++;
+            return pooled;
+        }
+
+        public void Clear()
+        {
+            _strings.Clear();
+            Hits = 0;
+            Chars = 0;
+        }
+    }
+}
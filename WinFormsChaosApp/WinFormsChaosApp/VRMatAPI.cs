@@ -16,10 +16,10 @@ namespace WinFormsChaosApp
         [Flags]
         public enum Rdt : uint
         {
-            None  ,
-            Float ,
-            Int ,
-            String
+            None = 0,
+            Float = 1 << 0,
+            Int = 1 << 1,
+            String = 1 << 2
         }
 
         public enum Sqdt : uint
@@ -29,6 +29,33 @@ namespace WinFormsChaosApp
             List = 1 << 9
         }
 
+        [Flags]
+        public enum MetaCategories : uint
+        {
+            None = 0,
+
+            RootVersion = 1 << 0,
+            RootCategory = 1 << 1,
+            RootPreview = 1 << 2,
+            RootTag = 1 << 3,
+            RootFileName = 1 << 4,
+
+            PluginName = 1 << 5,
+            PluginType = 1 << 6,
+            PluginClass = 1 << 7,
+            PluginVersion = 1 << 8,
+
+            ParamName = 1 << 9,
+            ParamType = 1 << 10,
+            ParamCustom = 1 << 11,
+            ParamFilePath = 1 << 12,
+
+            Root = RootVersion | RootCategory | RootPreview | RootTag | RootFileName,
+            Plugin = PluginName | PluginType | PluginClass | PluginVersion,
+            Param = ParamName | ParamType | ParamCustom | ParamFilePath,
+            All = Root | Plugin | Param
+        }
+
         public enum Stdt : uint
         {
             None = 0,
@@ -45,9 +72,14 @@ namespace WinFormsChaosApp
         [DllImport(ConstDll, CallingConvention = CallingConvention.Cdecl)]
         public static extern void DataContainer_Destroy(IntPtr dc);
 
+        // frees the strings owned by the container when it unmarshals them, read meta through the MetaNative overload instead
         [DllImport(ConstDll, CallingConvention = CallingConvention.Cdecl)]
         public static extern int DataContainer_GetMeta(IntPtr dc, uint element, ref Meta meta);
 
+        // the container owns the returned strings, so they must be read as raw pointers and not freed by the marshaller
+        [DllImport(ConstDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int DataContainer_GetMeta(IntPtr dc, uint element, ref MetaNative meta);
+
         [DllImport(ConstDll, CallingConvention = CallingConvention.Cdecl)]
         public static extern void DataContainer_GetUniqueName(IntPtr dc, string pluginName, UniqueNameCallback resultHandler, IntPtr userData);
 
@@ -63,6 +95,9 @@ namespace WinFormsChaosApp
         [DllImport(ConstDll, CallingConvention = CallingConvention.Cdecl)]
         public static extern int DataContainer_SetMeta(IntPtr dc, uint element, ref Meta meta);
 
+        [DllImport(ConstDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int DataContainer_SetMeta(IntPtr dc, uint element, ref MetaNative meta);
+
         [DllImport(ConstDll, CallingConvention = CallingConvention.Cdecl)]
         public static extern uint DataContainer_AddPlugin(IntPtr dc, string name, string type, string klass);
 
@@ -94,7 +129,7 @@ namespace WinFormsChaosApp
 
 
         // Define struct for Meta
-        [StructLayout(LayoutKind.Sequential, CharSet = CharSet.Ansi)]
+        [StructLayout(LayoutKind.Sequential, CharSet = CharSet.Ansi, Pack = 1)]
         public struct Meta
         {
             public uint mask;
@@ -122,7 +157,28 @@ namespace WinFormsChaosApp
             public int paramFilePath;
         }
 
-        [StructLayout(LayoutKind.Sequential)]
+        // Same layout as Meta, but with the strings left as pointers into the container
+        [StructLayout(LayoutKind.Sequential, Pack = 1)]
+        public struct MetaNative
+        {
+            public uint mask;
+            public int version;
+            public IntPtr category;
+            public IntPtr preview;
+            public IntPtr tag;
+            public IntPtr fileName;
+            public IntPtr pluginName;
+            public IntPtr pluginType;
+            public IntPtr pluginClass;
+            public int pluginVersion;
+            public IntPtr paramName;
+            public IntPtr paramType;
+            public int paramCustom;
+            public int paramFilePath;
+        }
+
+        // exports.h declares ValueData inside #pragma pack(1), so data follows listCount..sqdt without padding
+        [StructLayout(LayoutKind.Sequential, Pack = 1)]
         public struct ValueData
         {
             public uint pluginId;
@@ -0,0 +1,363 @@
+﻿using System.Buffers;
+using System.Buffers.Text;
+using System.Xml;
+
+namespace WinFormsChaosApp
+{
+    /// <summary>
+    /// A plugin reported by VRMatScanner. The same instance is reused for every plugin of a scan
+    /// </summary>
+    public sealed class ScanPlugin
+    {
+        public string Name { get; internal set; } = "";
+        public string Type { get; internal set; } = "";
+        public string Class { get; internal set; } = "";
+        public int Version { get; internal set; }
+    }
+
+    /// <summary>
+    /// A parameter reported by VRMatScanner. The same instance is reused for every parameter of a scan
+    /// </summary>
+    public sealed class ScanParameter
+    {
+        internal readonly List<string> _values = new();
+
+        public ScanPlugin Plugin { get; internal set; } = null!;
+        public string Name { get; internal set; } = "";
+        public string Type { get; internal set; } = "";
+        public bool Custom { get; internal set; }
+        public bool FilePath { get; internal set; }
+
+        /// <summary>
+        /// The text of every leaf in the value, in document order - one entry for scalars and strings,
+        /// 3 for a color, 12 for a transform, one per item for lists
+        /// </summary>
+        public IReadOnlyList<string> Values => _values;
+    }
+
+    /// <summary>
+    /// Return false to stop the scan
+    /// </summary>
+    public delegate bool ScanPluginHandler(ScanPlugin plugin);
+
+    /// <summary>
+    /// Return false to stop the scan
+    /// </summary>
+    public delegate bool ScanParameterHandler(ScanParameter parameter);
+
+    /// <summary>
+    /// Reads a .vrmat/.vropt document forward-only and reports its plugins and parameters without building a data container.
+    /// Memory use does not depend on the document size - the preview is skipped and only the current parameter is held.
+    /// Understands the version 0 &lt;Asset&gt;/&lt;vrayplugin&gt;/&lt;parameter&gt; layout, the version 1 &lt;plugin&gt;/&lt;prop&gt; layout
+    /// and the legacy &lt;vismat&gt;/&lt;visopt&gt; roots
+    /// </summary>
+    public sealed class VRMatScanner
+    {
+        private readonly ScanPlugin _plugin = new();
+        private readonly ScanParameter _parameter = new();
+
+        public ScanPluginHandler? OnPlugin { get; set; }
+        public ScanParameterHandler? OnParameter { get; set; }
+
+        /// <summary>
+        /// If set, only plugins of these types are reported, together with their parameters
+        /// </summary>
+        public ISet<string>? PluginTypes { get; set; }
+
+        /// <summary>
+        /// If set, only parameters with these names are reported
+        /// </summary>
+        public ISet<string>? ParamNames { get; set; }
+
+        /// <summary>
+        /// The root tag of the last scanned document, valid from the first callback on
+        /// </summary>
+        public string Tag { get; private set; } = "";
+
+        /// <summary>
+        /// The XML layout version of the last scanned document
+        /// </summary>
+        public int Version { get; private set; }
+
+        public string? Category { get; private set; }
+
+        /// <summary>
+        /// Whether the last scanned document has a &lt;preview&gt;. The preview itself is skipped, use ReadPreview() to get it
+        /// </summary>
+        public bool HasPreview { get; private set; }
+
+        /// <summary>
+        /// The line of the &lt;preview&gt; element in the last scanned document, or 0
+        /// </summary>
+        public int PreviewLine { get; private set; }
+
+        /// <returns>True if the whole document was scanned, false if a callback stopped it</returns>
+        public bool ScanFile(string fileName)
+        {
+            using var stream = new FileStream(fileName, FileMode.Open, FileAccess.Read, FileShare.Read, 1 << 16, FileOptions.SequentialScan);
+            return Scan(stream);
+        }
+
+        /// <returns>True if the whole document was scanned, false if a callback stopped it</returns>
+        public bool ScanBuffer(string buffer)
+        {
+            using var reader = new StringReader(buffer);
+            return Scan(XmlReader.Create(reader, Settings()));
+        }
+
+        /// <returns>True if the whole document was scanned, false if a callback stopped it</returns>
+        public bool Scan(Stream stream)
+        {
+            using var reader = XmlReader.Create(stream, Settings());
+            return Scan(reader);
+        }
+
+        private bool Scan(XmlReader reader)
+        {
+            reader.MoveToContent();
+
+            Tag = reader.LocalName;
+            Version = int.TryParse(reader.GetAttribute("version"), out var version) ? version : 0;
+            Category = reader.GetAttribute("category");
+            HasPreview = false;
+            PreviewLine = 0;
+
+            string assetUrl = "", assetClass = "";
+            bool skipped = false;
+
+            while (skipped || reader.Read())
+            {
+                skipped = false;
+                if (reader.NodeType != XmlNodeType.Element)
+                    continue;
+
+                switch (reader.LocalName)
+                {
+                    case "preview":
+                        HasPreview = true;
+                        PreviewLine = (reader as IXmlLineInfo)?.LineNumber ?? 0;
+                        reader.Skip();
+                        skipped = true;
+                        break;
+
+                    // version 0 - the name and the class are on <Asset>, the type is on the nested <vrayplugin>
+                    case "Asset":
+                        assetUrl = reader.GetAttribute("url") ?? "";
+                        assetClass = reader.GetAttribute("type") ?? "";
+                        break;
+
+                    case "vrayplugin":
+                        if (!BeginPlugin(reader, assetUrl, reader.GetAttribute("name"), reader.GetAttribute("type") ?? assetClass, out skipped))
+                            return false;
+                        break;
+
+                    // version 1 - <plugin> carries everything, the version 0 <plugin> wrapper has no attributes
+                    case "plugin":
+                        if (reader.GetAttribute("name") is string name && !BeginPlugin(reader, name, reader.GetAttribute("type"), reader.GetAttribute("class"), out skipped))
+                            return false;
+                        break;
+
+                    case "parameter":
+                        if (!ReadParameter(reader, reader.GetAttribute("name") ?? reader.GetAttribute("label"), reader.GetAttribute("isUserData"), reader.GetAttribute("handler") == "FileBrowserHandler", out skipped))
+                            return false;
+                        break;
+
+                    case "prop":
+                        if (!ReadParameter(reader, reader.GetAttribute("name"), reader.GetAttribute("custom"), reader.GetAttribute("filepath") == "1", out skipped))
+                            return false;
+                        break;
+                }
+            }
+
+            return true;
+        }
+
+        private bool BeginPlugin(XmlReader reader, string name, string? type, string? klass, out bool skipped)
+        {
+            _plugin.Name = name;
+            _plugin.Type = type ?? "";
+            _plugin.Class = klass ?? "";
+            _plugin.Version = int.TryParse(reader.GetAttribute("version"), out var version) ? version : 0;
+
+            skipped = false;
+            if (PluginTypes != null && !PluginTypes.Contains(_plugin.Type))
+            {
+                reader.Skip();
+                skipped = true;
+                return true;
+            }
+
+            return OnPlugin == null || OnPlugin(_plugin);
+        }
+
+        private bool ReadParameter(XmlReader reader, string? name, string? custom, bool filePath, out bool skipped)
+        {
+            skipped = false;
+            if (OnParameter == null || (ParamNames != null && !ParamNames.Contains(name ?? "")))
+            {
+                reader.Skip();
+                skipped = true;
+                return true;
+            }
+
+            _parameter.Plugin = _plugin;
+            _parameter.Name = name ?? "";
+            _parameter.Type = reader.GetAttribute("type") ?? "";
+            _parameter.Custom = custom == "1";
+            _parameter.FilePath = filePath;
+            _parameter._values.Clear();
+
+            if (!reader.IsEmptyElement)
+            {
+                int depth = reader.Depth;
+                while (reader.Read() && reader.Depth > depth)
+                {
+                    if (reader.NodeType == XmlNodeType.Text || reader.NodeType == XmlNodeType.CDATA)
+                        _parameter._values.Add(reader.Value);
+                }
+            }
+
+            return OnParameter(_parameter);
+        }
+
+        /// <summary>
+        /// Decodes the base64 &lt;preview&gt; of a document straight into a caller buffer
+        /// </summary>
+        /// <returns>The number of image bytes written, 0 if the document has no preview</returns>
+        public static int ReadPreview(string fileName, byte[] buffer)
+        {
+            using var destination = new MemoryStream(buffer, true);
+
+            try
+            {
+                return (int)ReadPreview(fileName, destination);
+            }
+            catch (NotSupportedException)
+            {
+                throw new ArgumentException("The buffer is too small for the preview image.", nameof(buffer));
+            }
+        }
+
+        /// <returns>The number of image bytes written, 0 if the document has no preview</returns>
+        public static long ReadPreview(string fileName, Stream destination)
+        {
+            using var stream = new FileStream(fileName, FileMode.Open, FileAccess.Read, FileShare.Read, 1 << 16, FileOptions.SequentialScan);
+            return ReadPreview(stream, destination);
+        }
+
+        /// <summary>
+        /// Streams the base64 text of the &lt;preview&gt; through the SIMD-accelerated System.Buffers.Text.Base64 decoder in fixed-size chunks,
+        /// so neither the encoded text nor the decoded image is ever held in memory as a whole
+        /// </summary>
+        /// <returns>The number of image bytes written, 0 if the document has no preview</returns>
+        public static long ReadPreview(Stream source, Stream destination)
+        {
+            using var reader = XmlReader.Create(source, Settings());
+            return ReadPreview(reader, destination);
+        }
+
+        /// <summary>
+        /// Same as ReadPreview(Stream, Stream) for a document that is already in memory as text
+        /// </summary>
+        /// <returns>The number of image bytes written, 0 if the document has no preview</returns>
+        public static long ReadPreview(TextReader source, Stream destination)
+        {
+            using var reader = XmlReader.Create(source, Settings());
+            return ReadPreview(reader, destination);
+        }
+
+        private static long ReadPreview(XmlReader reader, Stream destination)
+        {
+            if (!FindPreview(reader))
+                return 0;
+
+            const int chunk = 1 << 16;
+            var chars = ArrayPool<char>.Shared.Rent(chunk);
+            var encoded = ArrayPool<byte>.Shared.Rent(chunk + 4);
+            var decoded = ArrayPool<byte>.Shared.Rent((chunk + 4) / 4 * 3);
+            long total = 0;
+
+            try
+            {
+                int pending = 0, count;
+                while ((count = reader.ReadValueChunk(chars, 0, chunk)) > 0)
+                {
+                    // base64 is ASCII, drop the line breaks and indentation
+                    for (int i = 0; i < count; i++)
+                    {
+                        if (chars[i] > ' ')
+                            encoded[pending++] = (byte)chars[i];
+                    }
+
+                    total += Decode(encoded, ref pending, decoded, destination, false);
+                }
+
+                total += Decode(encoded, ref pending, decoded, destination, true);
+            }
+            finally
+            {
+                ArrayPool<char>.Shared.Return(chars);
+                ArrayPool<byte>.Shared.Return(encoded);
+                ArrayPool<byte>.Shared.Return(decoded);
+            }
+
+            VRMatStats.AddPreviewBytes(total);
+            return total;
+        }
+
+        private static bool FindPreview(XmlReader reader)
+        {
+            reader.MoveToContent();
+
+            // the preview is a child of the root in version 1 and of the last <Asset> in version 0,
+            // plugin bodies are skipped without being parsed into values
+            bool skipped = false;
+            while (skipped || reader.Read())
+            {
+                skipped = false;
+                if (reader.NodeType != XmlNodeType.Element)
+                    continue;
+
+                if (reader.LocalName == "preview")
+                    return !reader.IsEmptyElement && reader.Read() && (reader.NodeType == XmlNodeType.Text || reader.NodeType == XmlNodeType.CDATA);
+
+                if (reader.LocalName == "plugin")
+                {
+                    reader.Skip();
+                    skipped = true;
+                }
+            }
+
+            return false;
+        }
+
+        private static int Decode(byte[] encoded, ref int pending, byte[] decoded, Stream destination, bool final)
+        {
+            // only the final block may carry '=' padding, so the last quad is held back until the end of the text
+            int length = final ? pending : Math.Max(0, (pending - 1) / 4 * 4);
+
+            var status = Base64.DecodeFromUtf8(encoded.AsSpan(0, length), decoded, out int consumed, out int written, final);
+            if (status == OperationStatus.InvalidData)
+                throw new FormatException("The preview is not a valid base64 string.");
+
+            destination.Write(decoded, 0, written);
+
+            // keep the incomplete quad for the next chunk
+            pending -= consumed;
+            Array.Copy(encoded, consumed, encoded, 0, pending);
+            return written;
+        }
+
+        private static XmlReaderSettings Settings()
+        {
+            return new XmlReaderSettings
+            {
+                IgnoreComments = true,
+                IgnoreWhitespace = true,
+                IgnoreProcessingInstructions = true,
+                DtdProcessing = DtdProcessing.Ignore,
+                CloseInput = false,
+            };
+        }
+    }
+}
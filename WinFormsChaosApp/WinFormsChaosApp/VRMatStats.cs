@@ -0,0 +1,186 @@
+﻿using System.Diagnostics;
+
+namespace WinFormsChaosApp
+{
+    /// <summary>
+    /// The vrmat.dll exports measured by VRMatStats
+    /// </summary>
+    public enum VRMatExport
+    {
+        Create,
+        Destroy,
+        Open,
+        Load,
+        Save,
+        GetMeta,
+        SetMeta,
+        AddPlugin,
+        AddParameter,
+        RemoveElement,
+        SetValue,
+        GetValue,
+        IteratorCreate,
+        IteratorIncrement,
+        IteratorDestroy,
+    }
+
+    /// <summary>
+    /// Called when a traced phase ends. The phases are "open", "load" and "save" of the native container
+    /// and "index", "graph" and "file order" of the managed lookups built on top of it
+    /// </summary>
+    /// <param name="file">The file of the container, or null for a buffer loaded through Container()</param>
+    public delegate void TraceSpanHandler(string phase, string? file, DateTime start, TimeSpan duration);
+
+    public readonly record struct ExportStats(long Calls, TimeSpan Time);
+
+    /// <summary>
+    /// A copy of the counters taken by VRMatStats.Snapshot()
+    /// </summary>
+    public sealed class VRMatStatsSnapshot
+    {
+        public IReadOnlyDictionary<VRMatExport, ExportStats> Exports { get; init; } = null!;
+
+        /// <summary>
+        /// The size of the opened files and the length of the loaded buffers
+        /// </summary>
+        public long BytesParsed { get; init; }
+
+        /// <summary>
+        /// Plugins and parameters added through the API. Elements read from a file are not counted,
+        /// the native loader does not report them
+        /// </summary>
+        public long PluginsCreated { get; init; }
+
+        public long ParametersCreated { get; init; }
+
+        /// <summary>
+        /// Decoded preview image bytes and preview text read through GetMeta()
+        /// </summary>
+        public long PreviewBytes { get; init; }
+
+        /// <summary>
+        /// The managed heap at the time of the snapshot
+        /// </summary>
+        public long HeapBytes { get; init; }
+
+        /// <summary>
+        /// The working set of the process at the time of the snapshot, an upper bound of what the native containers hold
+        /// </summary>
+        public long ProcessBytes { get; init; }
+    }
+
+    /// <summary>
+    /// Process-wide call counts, timings and volume counters of the data container API.
+    /// Off by default - while disabled every measuring point costs one static field read.
+    /// The counters are updated with interlocked operations, so containers used from several threads are counted correctly
+    /// </summary>
+    public static class VRMatStats
+    {
+        private static readonly long[] _calls = new long[Enum.GetValues<VRMatExport>().Length];
+        private static readonly long[] _ticks = new long[_calls.Length];
+
+        private static long _bytesParsed;
+        private static long _pluginsCreated;
+        private static long _parametersCreated;
+        private static long _previewBytes;
+
+        public static bool Enabled { get; set; }
+
+        /// <summary>
+        /// Receives the traced phases while Enabled is set
+        /// </summary>
+        public static event TraceSpanHandler? Span;
+
+        public static VRMatStatsSnapshot Snapshot()
+        {
+            var exports = new Dictionary<VRMatExport, ExportStats>(_calls.Length);
+            for (int i = 0; i < _calls.Length; i++)
+                exports[(VRMatExport)i] = new ExportStats(Interlocked.Read(ref _calls[i]), Stopwatch.GetElapsedTime(0, Interlocked.Read(ref _ticks[i])));
+
+            return new VRMatStatsSnapshot
+            {
+                Exports = exports,
+                BytesParsed = Interlocked.Read(ref _bytesParsed),
+                PluginsCreated = Interlocked.Read(ref _pluginsCreated),
+                ParametersCreated = Interlocked.Read(ref _parametersCreated),
+                PreviewBytes = Interlocked.Read(ref _previewBytes),
+                HeapBytes = GC.GetTotalMemory(false),
+                ProcessBytes = Environment.WorkingSet,
+            };
+        }
+
+        public static void Reset()
+        {
+            for (int i = 0; i < _calls.Length; i++)
+            {
+                Interlocked.Exchange(ref _calls[i], 0);
+                Interlocked.Exchange(ref _ticks[i], 0);
+            }
+
+            Interlocked.Exchange(ref _bytesParsed, 0);
+            Interlocked.Exchange(ref _pluginsCreated, 0);
+            Interlocked.Exchange(ref _parametersCreated, 0);
+            Interlocked.Exchange(ref _previewBytes, 0);
+        }
+
+        /// <returns>The start of a measurement, 0 while disabled</returns>
+        internal static long Begin()
+        {
+            return Enabled ? Stopwatch.GetTimestamp() : 0;
+        }
+
+        internal static void End(VRMatExport export, long start)
+        {
+            if (start == 0)
+                return;
+
+            Interlocked.Increment(ref _calls[(int)export]);
+            Interlocked.Add(ref _ticks[(int)export], Stopwatch.GetTimestamp() - start);
+        }
+
+        /// <summary>
+        /// Ends the measurement of an export that is also reported as a trace span
+        /// </summary>
+        internal static void End(VRMatExport export, long start, string phase, string? file)
+        {
+            if (start == 0)
+                return;
+
+            End(export, start);
+            EndSpan(phase, file, start);
+        }
+
+        internal static void EndSpan(string phase, string? file, long start)
+        {
+            if (start == 0 || Span is not TraceSpanHandler span)
+                return;
+
+            var duration = Stopwatch.GetElapsedTime(start);
+            span(phase, file, DateTime.Now - duration, duration);
+        }
+
+        internal static void AddBytesParsed(long bytes)
+        {
+            if (Enabled)
+                Interlocked.Add(ref _bytesParsed, bytes);
+        }
+
+        internal static void AddPluginCreated()
+        {
+            if (Enabled)
+                Interlocked.Increment(ref _pluginsCreated);
+        }
+
+        internal static void AddParameterCreated()
+        {
+            if (Enabled)
+                Interlocked.Increment(ref _parametersCreated);
+        }
+
+        internal static void AddPreviewBytes(long bytes)
+        {
+            if (Enabled)
+                Interlocked.Add(ref _previewBytes, bytes);
+        }
+    }
+}